@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <vector>
 #include <queue>
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <cstdlib>
@@ -9,6 +10,13 @@
 #include <getopt.h> 
 #include <iostream>
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <deque>
+#include "events.h"
 using namespace std;
 
 
@@ -37,13 +45,25 @@ size_t ctx_switches = 0;
 size_t process_exits = 0;      
 unsigned long long cost = 0;   
 
+EventWriter* event_log = nullptr;   // set by --events
+uint32_t event_inst = 0;            // index of the instruction being simulated
+
+inline void log_event(uint8_t type, int pid, int vpage, int frame, uint32_t event_cost,
+                      char op = 0, int cpu = -1) {
+    if (event_log) event_log->log(type, event_inst, pid, vpage, frame, event_cost, op, cpu);
+}
+
+// A frame names its owner by the index of the owner's PTE in page_tables,
+// so pagers reach the PTE with one lookup instead of going through Process.
 struct Frame {
-    int pid;    
-    int vpage;
+    int pte;        // pid * MAX_VPAGES + vpage, -1 when the frame is free
     uint32_t age;
     size_t last_reference;
 };
 
+inline int frame_pid(const Frame& frame) { return frame.pte / MAX_VPAGES; }
+inline int frame_vpage(const Frame& frame) { return frame.pte % MAX_VPAGES; }
+
 
 struct PTE {
     unsigned int present : 1;
@@ -64,11 +84,17 @@ struct VMA {
 };
 
 
+// Process is only a small handle: the page tables and VMAs of all processes
+// live in two contiguous arenas (page_tables, vma_table), and the counters,
+// which are written but never read during simulation, in proc_stats.
 struct Process {
     int id;
-    vector<VMA> vmas;
-    PTE page_table[MAX_VPAGES];
+    PTE* page_table;    // MAX_VPAGES entries inside page_tables
+    int first_vma;      // range inside vma_table
+    int num_vmas;
+};
 
+struct ProcessStats {
     int unmaps = 0;
     int maps = 0;
     int ins = 0;
@@ -78,10 +104,13 @@ struct Process {
     int segprot = 0;
     int fins=0;
     int fouts=0; 
+    int steals = 0;   // pages of this process unmapped to serve another process
 };
 
+vector<PTE> page_tables;
+vector<VMA> vma_table;
+vector<ProcessStats> proc_stats;
 std::vector<Frame> frame_table; 
-queue<int> free_list;
 
 vector<int> randvals;  
 int ofs = 0; 
@@ -111,15 +140,20 @@ public:
     virtual Frame* select_victim_frame() = 0; 
 };
 
+// A pager only ever looks at the frames of its own partition. In global mode
+// there is a single partition holding every frame; the partition can shrink or
+// grow underneath the pager when frames are rebalanced, so hands are clamped.
 class FIFOPager : public Pager {
     int hand;
-    int MAX_FRAMES; 
+    vector<int>& frames;
 
 public:
-    FIFOPager(int num) : hand(0), MAX_FRAMES(num) {}
+    FIFOPager(vector<int>& part) : hand(0), frames(part) {}
 
     Frame* select_victim_frame() override {
-        Frame* victim_frame = &(frame_table)[hand];
+        int MAX_FRAMES = frames.size();
+        if (hand >= MAX_FRAMES) hand = 0;
+        Frame* victim_frame = &(frame_table)[frames[hand]];
 
         hand = (hand + 1) % MAX_FRAMES;
 
@@ -128,34 +162,34 @@ public:
 };
 
 class RandomPager : public Pager {
-    int MAX_FRAMES;
+    vector<int>& frames;
 public:
-    RandomPager(int num) : MAX_FRAMES(num) {}
+    RandomPager(vector<int>& part) : frames(part) {}
     Frame* select_victim_frame() override {
-        int random_index = myrandom(MAX_FRAMES)-1; 
-        return &(frame_table)[random_index];
+        int random_index = myrandom(frames.size())-1; 
+        return &(frame_table)[frames[random_index]];
     }
 };
 
 class ClockPager : public Pager {
     int hand; 
-    vector<Process>& processes; 
-    int MAX_FRAMES;
+    vector<int>& frames;
 
 public:
-    ClockPager(vector<Process>& procs, int num) : hand(0), processes(procs), MAX_FRAMES(num) {}
+    ClockPager(vector<int>& part) : hand(0), frames(part) {}
 
     Frame* select_victim_frame() override {
+        int MAX_FRAMES = frames.size();
+        if (hand >= MAX_FRAMES) hand = 0;
         while (true) {
-            Frame& frame = (frame_table)[hand];
-            Process& process = processes[frame.pid];
-            PTE* pte = &process.page_table[frame.vpage];
+            Frame& frame = (frame_table)[frames[hand]];
+            PTE* pte = &page_tables[frame.pte];
 
             if (pte->referenced == 1) {
                 pte->referenced = 0;
                 hand = (hand + 1) % MAX_FRAMES;
             } else {
-                Frame* victim_frame = &(frame_table)[hand];
+                Frame* victim_frame = &frame;
                 hand = (hand + 1) % MAX_FRAMES;
                 return victim_frame;
             }
@@ -166,12 +200,13 @@ public:
 
 class AgingPager : public Pager {
     int hand;                   
-    vector<Process>& processes; 
-    int MAX_FRAMES;
+    vector<int>& frames;
 public:
-    AgingPager(vector<Process>& procs, int num) : hand(0), processes(procs), MAX_FRAMES(num) {}
+    AgingPager(vector<int>& part) : hand(0), frames(part) {}
 
     Frame* select_victim_frame() override {
+        int MAX_FRAMES = frames.size();
+        if (hand >= MAX_FRAMES) hand = 0;
         int victim_index = -1;
         uint32_t min_age = UINT32_MAX; 
         int frames_scanned = 0;
@@ -180,8 +215,8 @@ public:
         for (int i = 0; i < MAX_FRAMES; i++) {
             frames_scanned++;
             int frame_index = (hand + i) % MAX_FRAMES; 
-            Frame& frame = (frame_table)[frame_index];
-            PTE* pte = &processes[frame.pid].page_table[frame.vpage];
+            Frame& frame = (frame_table)[frames[frame_index]];
+            PTE* pte = &page_tables[frame.pte];
 
             frame.age = (frame.age >> 1) | (pte->referenced ? 0x80000000 : 0);
 
@@ -195,7 +230,7 @@ public:
 
         hand = (victim_index + 1) % MAX_FRAMES;
 
-        return &(frame_table)[victim_index];
+        return &(frame_table)[frames[victim_index]];
     }
 };
 
@@ -203,15 +238,16 @@ public:
 
 class WorkingSetPager : public Pager {
     int hand;                  
-    vector<Process>& processes; 
     const int tau;              
-    int MAX_FRAMES;
+    vector<int>& frames;
 
 public:
-    WorkingSetPager(vector<Process>& procs, int tau_window, int num) 
-        : hand(0), processes(procs), tau(tau_window), MAX_FRAMES(num) {}
+    WorkingSetPager(int tau_window, vector<int>& part) 
+        : hand(0), tau(tau_window), frames(part) {}
 
     Frame* select_victim_frame() override {
+        int MAX_FRAMES = frames.size();
+        if (hand >= MAX_FRAMES) hand = 0;
         int victim_index = -1;         
         int oldest_time = INT_MAX;    
         int frames_scanned = 0;       
@@ -220,8 +256,8 @@ public:
         for (int i = 0; i < MAX_FRAMES; i++) {
             frames_scanned++;
             int frame_index = (hand+i) % MAX_FRAMES; 
-            Frame& frame = (frame_table)[frame_index];
-            PTE* pte = &processes[frame.pid].page_table[frame.vpage];
+            Frame& frame = (frame_table)[frames[frame_index]];
+            PTE* pte = &page_tables[frame.pte];
 
             int time_since_last_reference = inst_count - frame.last_reference;
 
@@ -230,7 +266,7 @@ public:
                 if (time_since_last_reference > tau) {
                     victim_index = frame_index;
                     hand = (frame_index + 1) % MAX_FRAMES; 
-                    return &(frame_table)[frame_index];
+                    return &(frame_table)[frames[frame_index]];
                 }
 
                 else if (frame.last_reference < oldest_time) {
@@ -249,7 +285,7 @@ public:
             victim_index = hand;
         }
         hand = (victim_index + 1) % MAX_FRAMES; 
-        return &(frame_table)[victim_index];
+        return &(frame_table)[frames[victim_index]];
     }
 };
 
@@ -257,15 +293,16 @@ public:
 
 class ESCNRUPager : public Pager {
     int hand;                   
-    vector<Process>& processes; 
     int last_reset_time;
-    int MAX_FRAMES;        
+    vector<int>& frames;
 
 public:
-    ESCNRUPager(vector<Process>& procs, int num) 
-        : hand(0), processes(procs), last_reset_time(0), MAX_FRAMES(num) {}
+    ESCNRUPager(vector<int>& part) 
+        : hand(0), last_reset_time(0), frames(part) {}
 
     Frame* select_victim_frame() override {
+        int MAX_FRAMES = frames.size();
+        if (hand >= MAX_FRAMES) hand = 0;
         int victim_index = -1;             
         int frames_scanned = 0;            
         bool reset_needed = (inst_count - last_reset_time) >= 48; 
@@ -276,8 +313,8 @@ public:
         for (int i = 0; i < MAX_FRAMES; i++) {
             frames_scanned++;
             int frame_index = (hand + i) % MAX_FRAMES; 
-            Frame& frame = (frame_table)[frame_index];
-            PTE* pte = &processes[frame.pid].page_table[frame.vpage];
+            Frame& frame = (frame_table)[frames[frame_index]];
+            PTE* pte = &page_tables[frame.pte];
 
             int frame_class = (pte->referenced << 1) | pte->modified;
 
@@ -306,42 +343,125 @@ public:
             last_reset_time = inst_count;
         }
 
-        return &(frame_table)[victim_index];
+        return &(frame_table)[frames[victim_index]];
     }
 };
 
 
-Pager* THE_PAGER = nullptr;
+// Frames are handed out per partition. Global replacement ('g') is a single
+// partition over the whole frame table; the other modes give every process its
+// own partition and its own pager instance, so victims are local to the faulter.
+//   s : static, equal share of frames per process
+//   p : proportional to the number of virtual pages covered by the VMAs
+//   f : page-fault-frequency, starts proportional and rebalances every PFF_WINDOW
+struct Partition {
+    vector<int> frames;
+    queue<int> free_list;
+    Pager* pager = nullptr;
+    int window_faults = 0;
+};
+
+const int PFF_WINDOW = 100;
+const int PFF_UPPER = 8;
+const int PFF_LOWER = 2;
+
+vector<Partition> partitions;
+char partition_mode = 'g';
+bool partition_report = false;  // -p given explicitly, print PART lines
+
+Partition& partition_for(int pid) {
+    return partition_mode == 'g' ? partitions[0] : partitions[pid];
+}
+
+Pager* create_pager(char algo, vector<int>& frames) {
+    switch (algo) {
+        case 'f': return new FIFOPager(frames);
+        case 'r': return new RandomPager(frames);
+        case 'c': return new ClockPager(frames);
+        case 'e': return new ESCNRUPager(frames);
+        case 'a': return new AgingPager(frames);
+        case 'w': return new WorkingSetPager(49, frames); // Default tau = 49
+        default:  return nullptr;
+    }
+}
+
+int vma_pages(const Process& process) {
+    int pages = 0;
+    for (int i = 0; i < process.num_vmas; i++) {
+        const VMA& vma = vma_table[process.first_vma + i];
+        pages += vma.end_vpage - vma.start_vpage + 1;
+    }
+    return pages;
+}
 
-void initialize_frame_table(int MAX_FRAMES) {
+bool initialize_frame_table(int MAX_FRAMES, vector<Process>& processes, char algo) {
     frame_table.resize(MAX_FRAMES);
     for (int i = 0; i < MAX_FRAMES; i++) {
-        frame_table[i] = {-1, -1, 0, 0};  
-        free_list.push(i);         
+        frame_table[i] = {-1, 0, 0};  
+    }
+
+    int num_partitions = partition_mode == 'g' ? 1 : processes.size();
+    if (num_partitions > MAX_FRAMES) return false;
+
+    vector<int> quota(num_partitions, 1);
+    if (partition_mode == 'g') {
+        quota[0] = MAX_FRAMES;
+    } else if (partition_mode == 's') {
+        for (int p = 0; p < num_partitions; p++) {
+            quota[p] = MAX_FRAMES / num_partitions + (p < MAX_FRAMES % num_partitions ? 1 : 0);
+        }
+    } else {
+        // every process keeps at least one frame, the rest is split by VMA size
+        int total_pages = 0;
+        for (const auto& process : processes) total_pages += vma_pages(process);
+        int spare = MAX_FRAMES - num_partitions;
+        int handed_out = 0;
+        for (int p = 0; p < num_partitions && total_pages > 0; p++) {
+            int share = (long long)spare * vma_pages(processes[p]) / total_pages;
+            quota[p] += share;
+            handed_out += share;
+        }
+        for (int p = 0; handed_out < spare; p = (p + 1) % num_partitions) {
+            quota[p]++;
+            handed_out++;
+        }
+    }
+
+    partitions.resize(num_partitions);
+    int next_frame = 0;
+    for (int p = 0; p < num_partitions; p++) {
+        for (int i = 0; i < quota[p]; i++) {
+            partitions[p].frames.push_back(next_frame);
+            partitions[p].free_list.push(next_frame);
+            next_frame++;
+        }
+        partitions[p].pager = create_pager(algo, partitions[p].frames);
+        if (partitions[p].pager == nullptr) return false;
     }
+    return true;
 }
 
-Frame* allocate_frame_from_free_list() {
-    if (free_list.empty()) return nullptr;
-    int frame_index = free_list.front();
-    free_list.pop();
+Frame* allocate_frame_from_free_list(Partition& partition) {
+    if (partition.free_list.empty()) return nullptr;
+    int frame_index = partition.free_list.front();
+    partition.free_list.pop();
     return &(frame_table)[frame_index];
 }
 
-Frame* get_frame() {
-    Frame* frame = allocate_frame_from_free_list();
+Frame* get_frame(Partition& partition) {
+    Frame* frame = allocate_frame_from_free_list(partition);
     if (frame != nullptr) {
         return frame; 
     }
 
-    return THE_PAGER->select_victim_frame();
+    return partition.pager->select_victim_frame();
 }
 
-
 const VMA* find_vma_for_page(Process* process, int vpage) {
-    for (const auto& vma : process->vmas) {
-        if (vpage >= vma.start_vpage && vpage <= vma.end_vpage) {
-            return &vma; 
+    const VMA* end = vma_table.data() + process->first_vma + process->num_vmas;
+    for (const VMA* vma = vma_table.data() + process->first_vma; vma != end; vma++) {
+        if (vpage >= vma->start_vpage && vpage <= vma->end_vpage) {
+            return vma; 
         }
     }
     return nullptr; 
@@ -379,9 +499,14 @@ vector<Process> read_processes(FILE* file) {
     int num_processes;
     sscanf(buffer, "%d", &num_processes);
 
+    processes.reserve(num_processes);
+    page_tables.resize(num_processes * MAX_VPAGES);
+    proc_stats.resize(num_processes);
+
     for (int i = 0; i < num_processes; i++) {
         Process process;
         process.id = i;
+        process.page_table = &page_tables[i * MAX_VPAGES];
         initialize_page_table(process.page_table);
         if (!read_line_func(file, buffer, sizeof(buffer))) {
             exit(EXIT_FAILURE);
@@ -389,6 +514,8 @@ vector<Process> read_processes(FILE* file) {
 
         int num_vmas;
         sscanf(buffer, "%d", &num_vmas);
+        process.first_vma = vma_table.size();
+        process.num_vmas = num_vmas;
 
         for (int j = 0; j < num_vmas; j++) {
 
@@ -408,7 +535,7 @@ vector<Process> read_processes(FILE* file) {
 
             vma.write_protected = (write_protected != 0);
             vma.file_mapped = (file_mapped != 0);
-            process.vmas.push_back(vma);
+            vma_table.push_back(vma);
         }
         processes.push_back(process);
     }
@@ -416,152 +543,573 @@ vector<Process> read_processes(FILE* file) {
     return processes;
 }
 
-bool get_next_instruction(char* operation, int* vpage) {
-    if (!input_file) {
-        return false;
+struct Instruction {
+    char operation;
+    int vpage;
+};
+
+// An instruction may carry a trailing CPU id ("r 14 1"); <cpu> is -1 when it
+// does not.
+bool get_next_instruction(FILE* file, Instruction* inst, int* cpu) {
+    while (read_line_func(file, buffer, sizeof(buffer))) {
+        int fields = sscanf(buffer, "%c %d %d", &inst->operation, &inst->vpage, cpu);
+        if (fields < 2) continue;
+        if (fields == 2) *cpu = -1;
+        return true;
     }
+    return false;
+}
 
-    while (read_line_func(input_file, buffer, sizeof(buffer))) {
-        if (sscanf(buffer, "%c %d", operation, vpage) == 2) {
-            return true; 
-        }
+// Each simulated CPU has its own current process; the frame table, free lists
+// and pagers are shared by all of them.
+struct Cpu {
+    int id;
+    Process* current_process;
+    ProcessStats* current_stats;
+};
+
+bool smp_trace = false;     // the trace carries CPU ids, echo them with -oO
+size_t next_rebalance = PFF_WINDOW;
+
+void print_instruction(size_t index, int cpu, char operation, int vpage) {
+    if (smp_trace) printf("%lu: ==> %c %d %d\n", index, operation, vpage, cpu);
+    else printf("%lu: ==> %c %d\n", index, operation, vpage);
+}
+
+void unmap_frame(vector<Process>& processes, Frame* frame, bool option_O) {
+    cost += COST_UNMAP;
+    int pid = frame_pid(*frame);
+    int vpage = frame_vpage(*frame);
+    Process* old_process = &processes[pid];
+    ProcessStats& old_stats = proc_stats[pid];
+    PTE* old_pte = &page_tables[frame->pte];
+    int frame_index = frame - &(frame_table)[0];
+    if (option_O) printf(" UNMAP %d:%d\n", pid, vpage);
+    log_event(EV_UNMAP, pid, vpage, frame_index, COST_UNMAP);
+    old_stats.unmaps++;
+    old_pte->present = 0;
+
+    if (old_pte->modified) {
+    const VMA* vma = find_vma_for_page(old_process, vpage);
+    if (vma && vma->file_mapped) {
+        cost+= COST_FOUT;
+        if (option_O) printf(" FOUT\n");
+        log_event(EV_FOUT, pid, vpage, frame_index, COST_FOUT);
+        old_stats.fouts++;
+    } else {
+        cost+= COST_OUT;
+        if (option_O) printf(" OUT\n");
+        log_event(EV_OUT, pid, vpage, frame_index, COST_OUT);
+        old_stats.outs++;
+        old_pte->pagedout = 1; 
+    }
     }
+}
 
-    return false; 
+// Take one frame away from partition <from> (a free one if it has any, else
+// the victim its own pager picks) and hand it to partition <to> as free.
+void move_frame(vector<Process>& processes, int from, int to, bool option_O) {
+    Partition& donor = partitions[from];
+    int frame_index;
+    if (!donor.free_list.empty()) {
+        frame_index = donor.free_list.front();
+        donor.free_list.pop();
+    } else {
+        Frame* victim = donor.pager->select_victim_frame();
+        frame_index = victim - &(frame_table)[0];
+        proc_stats[frame_pid(*victim)].steals++;
+        unmap_frame(processes, victim, option_O);
+    }
+    if (option_O) printf(" MOVE %d: %d -> %d\n", frame_index, from, to);
+    log_event(EV_MOVE, from, to, frame_index, 0);
+
+    Frame& frame = (frame_table)[frame_index];
+    frame.pte = -1;
+    frame.last_reference = 0;
+    frame.age = 0;
+
+    donor.frames.erase(find(donor.frames.begin(), donor.frames.end(), frame_index));
+    partitions[to].frames.push_back(frame_index);
+    partitions[to].free_list.push(frame_index);
+}
+
+// Page-fault-frequency rebalancing: every partition that faulted more than
+// PFF_UPPER times in the last window takes a frame from the partition with the
+// fewest faults, provided that one stayed under PFF_LOWER and can spare it.
+void rebalance_partitions(vector<Process>& processes, bool option_O) {
+    int num_partitions = partitions.size();
+    for (int to = 0; to < num_partitions; to++) {
+        if (partitions[to].window_faults <= PFF_UPPER) continue;
+
+        int from = -1;
+        for (int p = 0; p < num_partitions; p++) {
+            if (p == to || partitions[p].frames.size() <= 1) continue;
+            if (partitions[p].window_faults >= PFF_LOWER) continue;
+            if (from == -1 || partitions[p].window_faults < partitions[from].window_faults) from = p;
+        }
+        if (from == -1) break;
+        move_frame(processes, from, to, option_O);
+    }
+    for (auto& partition : partitions) partition.window_faults = 0;
 }
 
-void simulate(vector<Process>& processes, bool option_O) {
+// Execute one trace instruction on <cpu>. Everything that touches the frame
+// table or the pagers goes through here, always from a single thread.
+void execute_instruction(vector<Process>& processes, Cpu& cpu, char operation, int vpage, bool option_O) {
+    Process* current_process = cpu.current_process;
+    ProcessStats* current_stats = cpu.current_stats;
+    event_inst = inst_count;
+    if (partition_mode == 'f' && inst_count >= next_rebalance) {
+        rebalance_partitions(processes, option_O);
+        // instructions committed in bulk may have skipped several windows
+        next_rebalance = (inst_count / PFF_WINDOW + 1) * PFF_WINDOW;
+    }
+    if (option_O) print_instruction(inst_count, cpu.id, operation, vpage);
+    log_event(EV_INSTR, current_process->id, vpage, -1,
+              operation == 'c' ? COST_CONTEXT_SWITCH :
+              operation == 'e' ? COST_PROCESS_EXIT : COST_READ_WRITE, operation,
+              smp_trace ? cpu.id : -1);
+
+    if (operation == 'c') {
+        inst_count++;
+        ctx_switches++;
+        cost += COST_CONTEXT_SWITCH;
+        cpu.current_process = &processes[vpage];
+        cpu.current_stats = &proc_stats[vpage];
+        return;
+    } else if (operation == 'e') {
+        if (option_O) printf("EXIT current process %d\n", current_process->id);
+        log_event(EV_EXIT, current_process->id, -1, -1, 0);
+        inst_count++;
+        process_exits++;
+        cost += COST_PROCESS_EXIT;
+        for (int vpage = 0; vpage < MAX_VPAGES; vpage++) {
+            PTE* pte = &current_process->page_table[vpage];
+
+            if (pte->present) {
+                if (option_O) printf(" UNMAP %d:%d\n", current_process->id, vpage);
+                log_event(EV_UNMAP, current_process->id, vpage, pte->frame, COST_UNMAP);
+                current_stats->unmaps++;
+                cost += COST_UNMAP;
+
+                const VMA* vma = find_vma_for_page(current_process, vpage);
+                if (vma && vma->file_mapped && pte->modified) {
+                    if (option_O) printf(" FOUT\n");
+                    log_event(EV_FOUT, current_process->id, vpage, pte->frame, COST_FOUT);
+                    current_stats->fouts++;
+                    cost += COST_FOUT;
+                }
+
+                Frame* frame = &(frame_table)[pte->frame];
+                frame->pte = -1;    
+                frame->last_reference =0;
+                frame->age = 0;
+                partition_for(current_process->id).free_list.push(pte->frame);   
+            }
+            
+            pte->present = 0;
+            pte->referenced = 0;
+            pte->modified = 0;
+            pte->write_protect = 0;
+            pte->pagedout = 0;
+            pte->frame = 0;
+        }
+        return;
+    }
+
+    inst_count++;
+    cost+= COST_READ_WRITE;
+    PTE* pte = &current_process->page_table[vpage];
+    const VMA* vma = find_vma_for_page(current_process, vpage);
     
+    if (!pte->present) {
+        if (!vma) {
+            cost += COST_SEGV;
+            if (option_O) printf(" SEGV\n");
+            log_event(EV_SEGV, current_process->id, vpage, -1, COST_SEGV);
+            current_stats->segv++;
+            return;
+        }
+
+        Partition& partition = partition_for(current_process->id);
+        partition.window_faults++;
+        Frame* new_frame = get_frame(partition);
+
+        if (new_frame->pte != -1) {
+            if (frame_pid(*new_frame) != current_process->id) proc_stats[frame_pid(*new_frame)].steals++;
+            unmap_frame(processes, new_frame, option_O);
+        }
+        
+        new_frame->last_reference = inst_count;
+        new_frame->age = 0;
+        new_frame->pte = current_process->id * MAX_VPAGES + vpage;
+        int frame_index = new_frame - &(frame_table)[0];
+
+        if (vma->file_mapped) {
+            cost += COST_FIN;
+            if (option_O) printf(" FIN\n");
+            log_event(EV_FIN, current_process->id, vpage, frame_index, COST_FIN);
+            current_stats->fins++;
+        } else if (pte->pagedout) {
+            cost += COST_IN;
+            if (option_O) printf(" IN\n");
+            log_event(EV_IN, current_process->id, vpage, frame_index, COST_IN);
+            current_stats->ins++;
+        } else {
+            cost += COST_ZERO;
+            if (option_O) printf(" ZERO\n");
+            log_event(EV_ZERO, current_process->id, vpage, frame_index, COST_ZERO);
+            current_stats->zeros++;
+        }
+
+        cost += COST_MAP;
+        if (option_O) printf(" MAP %d\n", frame_index);
+        log_event(EV_MAP, current_process->id, vpage, frame_index, COST_MAP);
+        current_stats->maps++;
+
+        pte->frame = frame_index;
+        pte->present = 1;
+        pte->referenced = 0;
+        pte->modified = 0;
+    }
+    if (vma->write_protected) pte->write_protect = 1;
+
+
+    pte->referenced = 1;
+    Frame& frame = (frame_table)[pte->frame];
+
+    if (operation == 'w') {
+        if (pte->write_protect) {
+            current_stats->segprot++;
+            cost += COST_SEGPROT;
+            if (option_O) printf(" SEGPROT\n");
+            log_event(EV_SEGPROT, current_process->id, vpage, pte->frame, COST_SEGPROT);
+        } else {
+            pte->modified = 1;
+        }
+    }
+}
+
+// <first> is the instruction main() already read to tell the trace type, or
+// nullptr for an empty trace.
+void simulate(vector<Process>& processes, const Instruction* first, bool option_O) {
+    Cpu cpu = {0, &processes[0], &proc_stats[0]};
+    if (first) execute_instruction(processes, cpu, first->operation, first->vpage, option_O);
+
+    Instruction inst;
+    int cpu_id;
+    while (get_next_instruction(input_file, &inst, &cpu_id)) {
+        if (cpu_id > 0) {
+            exit(EXIT_FAILURE);     // only traces that start with a CPU id are multi-CPU
+        }
+        execute_instruction(processes, cpu, inst.operation, inst.vpage, option_O);
+    }
+}
+
+// Multi-CPU traces are read and simulated one epoch at a time: up to
+// EPOCH_LENGTH instructions per CPU, reading at most MAX_LOOKAHEAD lines past
+// what the epoch needs. An epoch runs in rounds. In the parallel phase of a
+// round every CPU whose current process is not current on any other active
+// CPU retires its run of page hits and SEGVs up to its next fault, context
+// switch or exit, and formats their -oO text and event records; these only
+// touch that process's PTEs and counters. The main thread then appends the
+// buffers in CPU-id order and executes each CPU's next instruction serially,
+// also in CPU-id order. Output depends only on the trace, never on the number
+// of threads or their timing.
+//
+// A round is only worth a thread handoff when at least two exclusive CPUs
+// start with PARALLEL_MIN_RUN page hits; the main thread checks this by
+// peeking at no more than that many instructions per CPU.
+const int EPOCH_LENGTH = 256;
+const int MAX_LOOKAHEAD = 64 * EPOCH_LENGTH;
+const int MAX_CPUS = 1024;
+const int PARALLEL_MIN_RUN = EPOCH_LENGTH / 4;
+
+struct Retired {
     char operation;
     int vpage;
-    Process* current_process = &processes[0]; 
-    int ins_count=0;
-    while (get_next_instruction(&operation, &vpage)) {
-        if (option_O) printf("%d: ==> %c %d\n",ins_count++, operation, vpage);
-
-        if (operation == 'c') {
-            inst_count++;
-            ctx_switches++;
-            cost += COST_CONTEXT_SWITCH;
-            current_process = &processes[vpage];
-            continue;
-        } else if (operation == 'e') {
-            if (option_O) printf("EXIT current process %d\n", current_process->id);
-            inst_count++;
-            process_exits++;
-            cost += COST_PROCESS_EXIT;
-            for (int vpage = 0; vpage < MAX_VPAGES; vpage++) {
-                PTE* pte = &current_process->page_table[vpage];
-
-                if (pte->present) {
-                    if (option_O) printf(" UNMAP %d:%d\n", current_process->id, vpage);
-                    current_process->unmaps++;
-                    cost += COST_UNMAP;
-
-                    const VMA* vma = find_vma_for_page(current_process, vpage);
-                    if (vma && vma->file_mapped && pte->modified) {
-                        if (option_O) printf(" FOUT\n");
-                        current_process->fouts++;
-                        cost += COST_FOUT;
-                    }
-
-                    Frame* frame = &(frame_table)[pte->frame];
-                    frame->pid = -1;    
-                    frame->vpage = -1;  
-                    frame->last_reference =0;
-                    frame->age = 0;
-                    free_list.push(pte->frame);   
+    uint8_t event;      // EV_INSTR for a plain hit, else EV_SEGV or EV_SEGPROT
+};
+
+struct CpuStream {
+    Cpu cpu;
+    deque<Instruction> backlog;     // read from the trace, not yet in an epoch
+    vector<Instruction> epoch;
+    size_t next;
+    bool exclusive;
+
+    // filled by the parallel phase, drained by commit_retired
+    vector<Retired> retired;
+    unsigned long long retired_cost;
+    size_t first_index;
+    string text;
+    vector<EventRecord> events;
+};
+
+void retire_local(CpuStream& cs) {
+    cs.retired.clear();
+    cs.retired_cost = 0;
+    if (!cs.exclusive) return;
+    Process* process = cs.cpu.current_process;
+    ProcessStats* stats = cs.cpu.current_stats;
+
+    while (cs.next < cs.epoch.size()) {
+        const Instruction& inst = cs.epoch[cs.next];
+        if (inst.operation != 'r' && inst.operation != 'w') break;
+
+        PTE* pte = &process->page_table[inst.vpage];
+        const VMA* vma = find_vma_for_page(process, inst.vpage);
+        uint8_t event = EV_INSTR;
+        unsigned long long inst_cost = COST_READ_WRITE;
+        if (!pte->present) {
+            if (vma) break;     // page fault, needs the frame table
+            stats->segv++;
+            event = EV_SEGV;
+            inst_cost += COST_SEGV;
+        } else {
+            if (vma->write_protected) pte->write_protect = 1;
+            pte->referenced = 1;
+            if (inst.operation == 'w') {
+                if (pte->write_protect) {
+                    stats->segprot++;
+                    event = EV_SEGPROT;
+                    inst_cost += COST_SEGPROT;
+                } else {
+                    pte->modified = 1;
                 }
-                
-                pte->present = 0;
-                pte->referenced = 0;
-                pte->modified = 0;
-                pte->write_protect = 0;
-                pte->pagedout = 0;
-                pte->frame = 0;
             }
-            continue;
         }
+        cs.retired.push_back({inst.operation, inst.vpage, event});
+        cs.retired_cost += inst_cost;
+        cs.next++;
+    }
+}
 
-        inst_count++;
-        cost+= COST_READ_WRITE;
-        PTE* pte = &current_process->page_table[vpage];
-        const VMA* vma = find_vma_for_page(current_process, vpage);
-        
-        if (!pte->present) {
-            if (!vma) {
-                cost += COST_SEGV;
-                if (option_O) printf(" SEGV\n");
-                current_process->segv++;
-                continue;
+// Number of page hits at the head of cs's epoch, counting at most <limit>.
+size_t leading_hits(const CpuStream& cs, size_t limit) {
+    const PTE* page_table = cs.cpu.current_process->page_table;
+    size_t n = 0;
+    for (size_t i = cs.next; i < cs.epoch.size() && n < limit; i++, n++) {
+        const Instruction& inst = cs.epoch[i];
+        if (inst.operation != 'r' && inst.operation != 'w') break;
+        if (!page_table[inst.vpage].present) break;
+    }
+    return n;
+}
+
+// Build the -oO text and event records of the retired instructions, numbered
+// from cs.first_index.
+void format_retired(CpuStream& cs, bool option_O) {
+    cs.text.clear();
+    cs.events.clear();
+    int pid = cs.cpu.current_process->id;
+    char line[64];
+    size_t index = cs.first_index;
+    for (const Retired& ret : cs.retired) {
+        if (option_O) {
+            int len = snprintf(line, sizeof(line), "%lu: ==> %c %d %d\n", index, ret.operation, ret.vpage, cs.cpu.id);
+            cs.text.append(line, len);
+            if (ret.event == EV_SEGV) cs.text.append(" SEGV\n");
+            else if (ret.event == EV_SEGPROT) cs.text.append(" SEGPROT\n");
+        }
+        if (event_log) {
+            cs.events.push_back({(uint32_t)index, COST_READ_WRITE, pid, ret.vpage, -1, (int16_t)cs.cpu.id, EV_INSTR, ret.operation});
+            if (ret.event == EV_SEGV) {
+                cs.events.push_back({(uint32_t)index, COST_SEGV, pid, ret.vpage, -1, -1, EV_SEGV, 0});
+            } else if (ret.event == EV_SEGPROT) {
+                int frame = cs.cpu.current_process->page_table[ret.vpage].frame;
+                cs.events.push_back({(uint32_t)index, COST_SEGPROT, pid, ret.vpage, frame, -1, EV_SEGPROT, 0});
             }
+        }
+        index++;
+    }
+}
 
-            Frame* new_frame = get_frame();
+void commit_retired(CpuStream& cs) {
+    if (!cs.text.empty()) fwrite(cs.text.data(), 1, cs.text.size(), stdout);
+    if (event_log && !cs.events.empty()) event_log->write(cs.events.data(), cs.events.size());
+    inst_count += cs.retired.size();
+    cost += cs.retired_cost;
+}
 
-            if (new_frame->pid != -1) {
-                cost += COST_UNMAP;
-                Process* old_process = &processes[new_frame->pid];
-                PTE* old_pte = &old_process->page_table[new_frame->vpage];
-                if (option_O) printf(" UNMAP %d:%d\n", new_frame->pid, new_frame->vpage);
-                old_process->unmaps++;
-                old_pte->present = 0;
-
-                if (old_pte->modified) {
-                const VMA* vma = find_vma_for_page(old_process, new_frame->vpage);
-                if (vma && vma->file_mapped) {
-                    cost+= COST_FOUT;
-                    if (option_O) printf(" FOUT\n");
-                    old_process->fouts++;
-                } else {
-                    cost+= COST_OUT;
-                    if (option_O) printf(" OUT\n");
-                    old_process->outs++;
-                    old_pte->pagedout = 1; 
-                }
-                }
+// Lets the workers of one job wait for each other.
+class SpinBarrier {
+    atomic<int> waiting{0};
+    atomic<int> phase{0};
+
+public:
+    void wait(int num_workers) {
+        int current = phase.load();
+        if (waiting.fetch_add(1) + 1 == num_workers) {
+            waiting.store(0);
+            phase.fetch_add(1);
+        } else {
+            while (phase.load() == current) this_thread::yield();
+        }
+    }
+};
+
+// Runs a job on every worker (the calling thread is worker 0) and returns once
+// all of them are done. Threads are kept for the whole simulation.
+class WorkerPool {
+    vector<thread> threads;
+    mutex m;
+    condition_variable start_cv;
+    condition_variable done_cv;
+    function<void(int, int)> job;
+    int generation = 0;
+    int running = 0;
+    bool stopping = false;
+
+    void worker(int w) {
+        int seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(m);
+                start_cv.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
             }
-            
-            new_frame->last_reference = inst_count;
-            new_frame->age = 0;
-            new_frame->pid = current_process->id;
-            new_frame->vpage = vpage;
-
-            if (vma->file_mapped) {
-                cost += COST_FIN;
-                if (option_O) printf(" FIN\n");
-                current_process->fins++;
-            } else if (pte->pagedout) {
-                cost += COST_IN;
-                if (option_O) printf(" IN\n");
-                current_process->ins++;
-            } else {
-                cost += COST_ZERO;
-                if (option_O) printf(" ZERO\n");
-                current_process->zeros++;
+            job(w, size());
+            {
+                lock_guard<mutex> lock(m);
+                if (--running == 0) done_cv.notify_one();
             }
+        }
+    }
 
-            cost += COST_MAP;
-            if (option_O) printf(" MAP %ld\n", new_frame - &(frame_table)[0]);
-            current_process->maps++;
+public:
+    WorkerPool(int num_threads) {
+        for (int w = 1; w < num_threads; w++) threads.emplace_back(&WorkerPool::worker, this, w);
+    }
 
-            pte->frame = new_frame - &(frame_table)[0];
-            pte->present = 1;
-            pte->referenced = 0;
-            pte->modified = 0;
+    ~WorkerPool() {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
         }
-        if (vma->write_protected) pte->write_protect = 1;
+        start_cv.notify_all();
+        for (auto& t : threads) t.join();
+    }
 
+    int size() const { return threads.size() + 1; }
 
-        pte->referenced = 1;
-        Frame& frame = (frame_table)[pte->frame];
+    // job(worker, num_workers); with parallel == false it runs inline as a
+    // single worker.
+    void run(const function<void(int, int)>& fn, bool parallel) {
+        if (!parallel || threads.empty()) {
+            fn(0, 1);
+            return;
+        }
+        {
+            lock_guard<mutex> lock(m);
+            job = fn;
+            running = threads.size();
+            generation++;
+        }
+        start_cv.notify_all();
+        fn(0, size());
+        unique_lock<mutex> lock(m);
+        done_cv.wait(lock, [&] { return running == 0; });
+    }
+};
 
-        if (operation == 'w') {
-            if (pte->write_protect) {
-                current_process->segprot++;
-                cost += COST_SEGPROT;
-                if (option_O) printf(" SEGPROT\n");
-            } else {
-                pte->modified = 1;
+// Stream of CPU <cpu>, created (along with any lower ones) on first use.
+CpuStream& cpu_stream(vector<Process>& processes, vector<CpuStream>& cpus, int cpu) {
+    if (cpu < 0) cpu = 0;
+    if (cpu >= MAX_CPUS) {
+        exit(EXIT_FAILURE);
+    }
+    while ((int)cpus.size() <= cpu) {
+        CpuStream cs;
+        cs.cpu = {(int)cpus.size(), &processes[0], &proc_stats[0]};
+        cs.next = 0;
+        cpus.push_back(std::move(cs));
+    }
+    return cpus[cpu];
+}
+
+// Read the next epoch into cpus[*].epoch; returns false once the trace is done.
+bool read_epoch(vector<Process>& processes, vector<CpuStream>& cpus) {
+    size_t buffered = 0;
+    int short_cpus = 0;
+    for (auto& cs : cpus) {
+        buffered += cs.backlog.size();
+        if (cs.backlog.size() < (size_t)EPOCH_LENGTH) short_cpus++;
+    }
+
+    Instruction inst;
+    int cpu;
+    while ((short_cpus > 0 || cpus.empty()) && buffered < (size_t)MAX_LOOKAHEAD &&
+           get_next_instruction(input_file, &inst, &cpu)) {
+        size_t known_cpus = cpus.size();
+        CpuStream& cs = cpu_stream(processes, cpus, cpu);
+        short_cpus += cpus.size() - known_cpus;
+        cs.backlog.push_back(inst);
+        buffered++;
+        if (cs.backlog.size() == (size_t)EPOCH_LENGTH) short_cpus--;
+    }
+
+    bool any = false;
+    for (auto& cs : cpus) {
+        size_t n = min(cs.backlog.size(), (size_t)EPOCH_LENGTH);
+        cs.epoch.assign(cs.backlog.begin(), cs.backlog.begin() + n);
+        cs.backlog.erase(cs.backlog.begin(), cs.backlog.begin() + n);
+        cs.next = 0;
+        if (n > 0) any = true;
+    }
+    return any;
+}
+
+// <first> and <first_cpu> are the instruction main() already read.
+void simulate_smp(vector<Process>& processes, const Instruction& first, int first_cpu,
+                  int num_threads, bool option_O) {
+    vector<CpuStream> cpus;
+    cpu_stream(processes, cpus, first_cpu).backlog.push_back(first);
+    vector<int> running_on(processes.size(), 0);
+    WorkerPool pool(num_threads);
+    SpinBarrier barrier;
+    bool format = option_O || event_log;
+
+    auto job = [&](int w, int num_workers) {
+        for (size_t i = w; i < cpus.size(); i += num_workers) retire_local(cpus[i]);
+        if (!format) return;
+        if (num_workers > 1) barrier.wait(num_workers);
+        size_t index = inst_count;
+        for (size_t i = 0; i < cpus.size(); i++) {
+            if ((int)(i % num_workers) == w) {
+                cpus[i].first_index = index;
+                format_retired(cpus[i], option_O);
+            }
+            index += cpus[i].retired.size();
+        }
+    };
+
+    while (read_epoch(processes, cpus)) {
+        while (true) {
+            bool active = false;
+            for (auto& cs : cpus) {
+                if (cs.next < cs.epoch.size()) {
+                    running_on[cs.cpu.current_process->id]++;
+                    active = true;
+                }
+            }
+            if (!active) break;
+            int long_runs = 0;
+            for (auto& cs : cpus) {
+                cs.exclusive = cs.next < cs.epoch.size() && running_on[cs.cpu.current_process->id] == 1;
+                if (cs.exclusive && long_runs < 2 &&
+                    leading_hits(cs, PARALLEL_MIN_RUN) == (size_t)PARALLEL_MIN_RUN) long_runs++;
+            }
+            for (auto& cs : cpus) running_on[cs.cpu.current_process->id] = 0;
+
+            pool.run(job, long_runs >= 2);
+            for (auto& cs : cpus) commit_retired(cs);
+
+            for (auto& cs : cpus) {
+                if (cs.next == cs.epoch.size()) continue;
+                const Instruction& inst = cs.epoch[cs.next++];
+                execute_instruction(processes, cs.cpu, inst.operation, inst.vpage, option_O);
             }
         }
     }
@@ -570,10 +1118,10 @@ void simulate(vector<Process>& processes, bool option_O) {
 void print_frame_table(int MAX_FRAMES) {
     printf("FT:");
     for (int i = 0; i < MAX_FRAMES; i++) {
-        if (frame_table[i].pid == -1) {
+        if (frame_table[i].pte == -1) {
             printf(" *");
         } else {
-            printf(" %d:%d", frame_table[i].pid, frame_table[i].vpage);
+            printf(" %d:%d", frame_pid(frame_table[i]), frame_vpage(frame_table[i]));
         }
     }
     printf("\n");
@@ -607,18 +1155,32 @@ void print_page_table(vector<Process>& processes) {
 }
 void print_statistics(vector<Process>& processes) {
     for (const auto& process : processes) {
+        const ProcessStats& stats = proc_stats[process.id];
         printf("PROC[%d]:", process.id);
-        printf(" U=%d", process.unmaps);
-        printf(" M=%d", process.maps);
-        printf(" I=%d", process.ins);
-        printf(" O=%d", process.outs);
-        printf(" FI=%d", process.fins);
-        printf(" FO=%d", process.fouts);
-        printf(" Z=%d", process.zeros);
-        printf(" SV=%d", process.segv);
-        printf(" SP=%d", process.segprot);
+        printf(" U=%d", stats.unmaps);
+        printf(" M=%d", stats.maps);
+        printf(" I=%d", stats.ins);
+        printf(" O=%d", stats.outs);
+        printf(" FI=%d", stats.fins);
+        printf(" FO=%d", stats.fouts);
+        printf(" Z=%d", stats.zeros);
+        printf(" SV=%d", stats.segv);
+        printf(" SP=%d", stats.segprot);
         printf("\n");
     }
+    if (!partition_report) return;
+
+    // F is the quota of the process's partition, or in global mode the number
+    // of frames it holds at the end of the run.
+    vector<int> resident(processes.size(), 0);
+    for (const auto& frame : frame_table) {
+        if (frame.pte != -1) resident[frame_pid(frame)]++;
+    }
+    for (const auto& process : processes) {
+        const ProcessStats& stats = proc_stats[process.id];
+        int frames = partition_mode == 'g' ? resident[process.id] : partitions[process.id].frames.size();
+        printf("PART[%d]: F=%d ST=%d\n", process.id, frames, stats.steals);
+    }
 }
 
 void print_total_cost(){
@@ -637,8 +1199,15 @@ int main(int argc, char* argv[]) {
     int num_frames = 16; 
     char algo_option = 'f'; 
     string options = "";
+    const char* events_file = nullptr;
+    int num_threads = 0;
+
+    static struct option long_options[] = {
+        {"events", required_argument, nullptr, 'E'},
+        {nullptr, 0, nullptr, 0}
+    };
 
-    while ((c = getopt(argc, argv, "f:a:o:")) != -1) {
+    while ((c = getopt_long(argc, argv, "f:a:o:p:t:", long_options, nullptr)) != -1) {
         switch (c) {
             case 'f':
                 num_frames = atoi(optarg);
@@ -649,6 +1218,16 @@ int main(int argc, char* argv[]) {
             case 'o':
                 options = optarg;
                 break;
+            case 'p':
+                partition_mode = optarg[0];
+                partition_report = true;
+                break;
+            case 'E':
+                events_file = optarg;
+                break;
+            case 't':
+                num_threads = atoi(optarg);
+                break;
             default:
                 abort();
         }
@@ -696,34 +1275,40 @@ int main(int argc, char* argv[]) {
 
     input_file = fopen(filename, "r");
     vector<Process> processes = read_processes(input_file);
+
+    // a trace is multi-CPU when its first instruction carries a CPU id
+    // and keeps it, so the trace can be a pipe
+    Instruction first;
+    int first_cpu;
+    bool have_first = get_next_instruction(input_file, &first, &first_cpu);
+    smp_trace = have_first && first_cpu >= 0;
     load_random_numbers(rfile);
     
-    initialize_frame_table(num_frames);
-
-    switch (algo_option) {
-        case 'f':
-            THE_PAGER = new FIFOPager(num_frames);
-            break;
-        case 'r':
-            THE_PAGER = new RandomPager(num_frames);
-            break;
-        case 'c':
-            THE_PAGER = new ClockPager(processes,num_frames);
-            break;
-        case 'e':
-            THE_PAGER = new ESCNRUPager(processes,num_frames);
-            break;
-        case 'a':
-            THE_PAGER = new AgingPager(processes,num_frames);
-            break;
-        case 'w':
-            THE_PAGER = new WorkingSetPager(processes, 49,num_frames); // Default tau = 49
-            break;
-        default:
+    if (partition_mode != 'g' && partition_mode != 's' &&
+        partition_mode != 'p' && partition_mode != 'f') {
+        return EXIT_FAILURE;
+    }
+    if (!initialize_frame_table(num_frames, processes, algo_option)) {
+        return EXIT_FAILURE;
+    }
+
+    EventWriter event_writer;
+    if (events_file) {
+        if (!event_writer.open(events_file)) {
             return EXIT_FAILURE;
+        }
+        event_log = &event_writer;
     }
 
-    simulate(processes, O_option);
+    if (!smp_trace) {
+        simulate(processes, have_first ? &first : nullptr, O_option);
+    } else {
+        if (num_threads <= 0) num_threads = max(1u, thread::hardware_concurrency());
+        simulate_smp(processes, first, first_cpu, num_threads, O_option);
+    }
+    if (!event_writer.close()) {
+        return EXIT_FAILURE;
+    }
 
     if (P_option) {
         print_page_table(processes);
@@ -739,7 +1324,7 @@ int main(int argc, char* argv[]) {
     }
 
     fclose(input_file);
-    delete THE_PAGER;
+    for (auto& partition : partitions) delete partition.pager;
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,79 @@
+#!/bin/bash
+
+#example INDIR=Inputs ./eventcheck.sh ./lab3 ./eventdump -t4
+#runs every input with -oO --events and checks that eventdump prints the -oO trace
+
+[[ ${#} -lt 2 ]] && echo "usage: $0 <program> <eventdump> <optionalargs>" && exit
+
+INDIR=${INDIR:-.}
+PROG=$1
+DUMP=$2
+shift 2
+PARGS=${*}
+LOG=${LOG:-eventcheck.log}
+
+INPUTS=${INPUTS:-"`seq 1 13`"}
+ALGOS=${ALGOS:-" f  r  c  e  a  w"}
+FRAMES=${FRAMES:-"16 31"}
+MODES=${MODES:-"g s p f"}
+
+[[ ! -x ${PROG} ]] && echo "program <$PROG> is not executable" && exit
+[[ ! -x ${DUMP} ]] && echo "eventdump <$DUMP> is not executable" && exit
+[[ ! -d ${INDIR} ]] && echo "inputdir <$INDIR> does not exist"  && exit
+
+TMP=$(mktemp -d)
+trap "rm -rf ${TMP}" EXIT
+
+declare -ai counters
+declare -i x=0
+declare -i failed=0
+for s in ${ALGOS}; do
+        let counters[$x]=0
+        let x=$x+1
+done
+
+rm -f ${LOG}
+
+echo "input  frames  mode  ${ALGOS}"
+
+for I in ${INPUTS}; do
+  for N in ${FRAMES}; do
+    for M in ${MODES}; do
+      OUTLINE=`printf "%-7s %-7s %-4s" "${I}" "${N}" "${M}"`
+      x=0
+      for A in ${ALGOS}; do
+        RUN="${PROG} -f${N} -a${A} -p${M} -oO ${PARGS} --events ${TMP}/ev ${INDIR}/in${I} ${INDIR}/rfile"
+        if ! ${RUN} > ${TMP}/trace 2>&1; then
+            echo "${RUN} failed" >> ${LOG}
+            OUTLINE=`printf "%s  o" "${OUTLINE}"`
+            let failed=$failed+1
+        elif ! ${DUMP} ${TMP}/ev > ${TMP}/dump 2>&1; then
+            echo "${DUMP} ${TMP}/ev failed after ${RUN}" >> ${LOG}
+            OUTLINE=`printf "%s  o" "${OUTLINE}"`
+            let failed=$failed+1
+        elif cmp -s ${TMP}/trace ${TMP}/dump; then
+            OUTLINE=`printf "%s  ." "${OUTLINE}"`
+            let counters[$x]=`expr ${counters[$x]} + 1`
+        else
+            echo "${RUN}" >> ${LOG}
+            cmp ${TMP}/trace ${TMP}/dump >> ${LOG} 2>&1
+            OUTLINE=`printf "%s  #" "${OUTLINE}"`
+            let failed=$failed+1
+        fi
+        let x=$x+1
+      done
+      echo "${OUTLINE}"
+    done
+  done
+done
+
+
+OUTLINE=`printf "%-20s" "SUM"`
+x=0
+for A in ${ALGOS}; do
+    OUTLINE=`printf "%s%3d" "${OUTLINE}" "${counters[$x]}"`
+    let x=$x+1
+done
+echo "${OUTLINE}"
+
+[[ ${failed} -eq 0 ]]
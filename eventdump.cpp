@@ -0,0 +1,24 @@
+// Converts a binary event log from `lab3 --events FILE` back into the text
+// that `lab3 -oO` prints for the same run.
+#include <cstdio>
+#include <cstdlib>
+#include "events.h"
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <eventfile>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    EventReader reader;
+    if (!reader.open(argv[1])) {
+        fprintf(stderr, "%s: not a valid event log\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    for (const EventRecord& rec : reader) {
+        print_event(stdout, rec);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+// Binary event log written by `lab3 --events FILE` and read back by eventdump.
+// The file is a EventFileHeader followed by fixed-size EventRecords in
+// simulation order, in host byte order.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint32_t EVENT_MAGIC = 0x56455656;   // "VVEV"
+const uint32_t EVENT_VERSION = 3;
+
+enum EventType : uint8_t {
+    EV_INSTR = 0,   // op/vpage: instruction as read from the trace, cpu: its CPU
+    EV_EXIT,        // pid: exiting process
+    EV_UNMAP,       // pid:vpage unmapped from frame
+    EV_OUT,
+    EV_FOUT,
+    EV_IN,
+    EV_FIN,
+    EV_ZERO,
+    EV_MAP,         // pid:vpage mapped into frame
+    EV_SEGV,
+    EV_SEGPROT,
+    EV_MOVE,        // frame moved from partition pid to partition vpage
+};
+
+struct EventFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+struct EventRecord {
+    uint32_t inst;      // instruction index, as numbered by -oO
+    uint32_t cost;      // cost charged for this event
+    int32_t pid;
+    int32_t vpage;
+    int32_t frame;
+    int16_t cpu;        // CPU of an EV_INSTR in a multi-CPU trace, -1 otherwise
+    uint8_t type;       // EventType
+    char op;            // trace operation for EV_INSTR, 0 otherwise
+};
+
+static_assert(sizeof(EventRecord) == 24, "EventRecord must stay 24 bytes");
+
+// Appends records to a large in-memory buffer and only touches the file when
+// the buffer fills up, so logging an event is a bounds check and a store.
+// A failed write is remembered and reported by flush() and close().
+class EventWriter {
+    static const size_t BUFFER_RECORDS = 1 << 16;
+    FILE* file;
+    EventRecord* buffer;
+    size_t used;
+    bool failed;
+
+public:
+    EventWriter() : file(nullptr), buffer(nullptr), used(0), failed(false) {}
+    ~EventWriter() { close(); }
+
+    bool open(const char* filename) {
+        file = fopen(filename, "wb");
+        if (!file) return false;
+        buffer = new EventRecord[BUFFER_RECORDS];
+        EventFileHeader header = {EVENT_MAGIC, EVENT_VERSION, sizeof(EventRecord), 0};
+        return fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    void log(uint8_t type, uint32_t inst, int pid, int vpage, int frame, uint32_t cost,
+             char op = 0, int cpu = -1) {
+        if (used == BUFFER_RECORDS) flush();
+        EventRecord& rec = buffer[used++];
+        rec.inst = inst;
+        rec.cost = cost;
+        rec.pid = pid;
+        rec.vpage = vpage;
+        rec.frame = frame;
+        rec.cpu = cpu;
+        rec.type = type;
+        rec.op = op;
+    }
+
+    void write(const EventRecord* records, size_t count) {
+        while (count > 0) {
+            if (used == BUFFER_RECORDS) flush();
+            size_t n = std::min(count, BUFFER_RECORDS - used);
+            memcpy(buffer + used, records, n * sizeof(EventRecord));
+            used += n;
+            records += n;
+            count -= n;
+        }
+    }
+
+    bool flush() {
+        if (used > 0 && fwrite(buffer, sizeof(EventRecord), used, file) != used) failed = true;
+        used = 0;
+        return !failed;
+    }
+
+    bool close() {
+        if (!file) return !failed;
+        flush();
+        if (fclose(file) != 0) failed = true;
+        delete[] buffer;
+        file = nullptr;
+        buffer = nullptr;
+        return !failed;
+    }
+};
+
+// Maps a log file read-only and exposes its records as an array.
+class EventReader {
+    void* map;
+    size_t map_size;
+    const EventRecord* records;
+    size_t count;
+
+public:
+    EventReader() : map(MAP_FAILED), map_size(0), records(nullptr), count(0) {}
+    ~EventReader() { close(); }
+
+    bool open(const char* filename) {
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(EventFileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        map_size = st.st_size;
+        map = mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) return false;
+
+        // a log that ends in a partial record was cut short
+        const EventFileHeader* header = (const EventFileHeader*)map;
+        if (header->magic != EVENT_MAGIC || header->version != EVENT_VERSION ||
+            header->record_size != sizeof(EventRecord) ||
+            (map_size - sizeof(EventFileHeader)) % sizeof(EventRecord) != 0) {
+            close();
+            return false;
+        }
+        records = (const EventRecord*)((const char*)map + sizeof(EventFileHeader));
+        count = (map_size - sizeof(EventFileHeader)) / sizeof(EventRecord);
+        return true;
+    }
+
+    void close() {
+        if (map != MAP_FAILED) munmap(map, map_size);
+        map = MAP_FAILED;
+        records = nullptr;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    const EventRecord& operator[](size_t i) const { return records[i]; }
+    const EventRecord* begin() const { return records; }
+    const EventRecord* end() const { return records + count; }
+};
+
+// Prints a record exactly as the -oO trace prints the same event.
+inline void print_event(FILE* out, const EventRecord& rec) {
+    switch (rec.type) {
+        case EV_INSTR:
+            if (rec.cpu >= 0) fprintf(out, "%u: ==> %c %d %d\n", rec.inst, rec.op, rec.vpage, rec.cpu);
+            else fprintf(out, "%u: ==> %c %d\n", rec.inst, rec.op, rec.vpage);
+            break;
+        case EV_EXIT:    fprintf(out, "EXIT current process %d\n", rec.pid); break;
+        case EV_UNMAP:   fprintf(out, " UNMAP %d:%d\n", rec.pid, rec.vpage); break;
+        case EV_OUT:     fprintf(out, " OUT\n"); break;
+        case EV_FOUT:    fprintf(out, " FOUT\n"); break;
+        case EV_IN:      fprintf(out, " IN\n"); break;
+        case EV_FIN:     fprintf(out, " FIN\n"); break;
+        case EV_ZERO:    fprintf(out, " ZERO\n"); break;
+        case EV_MAP:     fprintf(out, " MAP %d\n", rec.frame); break;
+        case EV_SEGV:    fprintf(out, " SEGV\n"); break;
+        case EV_SEGPROT: fprintf(out, " SEGPROT\n"); break;
+        case EV_MOVE:    fprintf(out, " MOVE %d: %d -> %d\n", rec.frame, rec.pid, rec.vpage); break;
+    }
+}
+
+#endif